@@ -47,8 +47,44 @@
  * (#gint)
  * * "height": The height of the picture; READONLY
  * (#gint)
- * * "maps": The filepath to *.yml file, containing both maps for cv::remap
+ * * "maps": The filepath to *.yml file, containing both maps for cv::remap,
+ * loaded together with the maps of all other pads when going to PAUSED
  * (#gstring)
+ * * "priority": The priority of the picture, pads with lower priority are
+ * the first to be skipped when the element is overloaded
+ * (#guint)
+ *
+ * When "adaptive-qos" is enabled, the element follows downstream QoS events
+ * and its own processing time. Under overload it steps down to
+ * nearest-neighbour interpolation, then shows unchanged and low-priority
+ * pads from a cached copy of their last remapped picture instead of
+ * remapping them, and finally drops every other output frame. Low-priority
+ * pads are still remapped in turn, one per output frame, so that they keep
+ * moving. Pads are never skipped with "use-umat". It steps back up once
+ * downstream catches up. Every level change is posted on the bus as a
+ * "remap-qos" element message.
+ *
+ * Without "use-umat" every pad is split into stripes that are remapped on a
+ * worker pool shared by all remap elements in the process. Stripes are kept
+ * small enough for OpenCV to remap them without its own threads, so the pool
+ * size bounds the remapping threads. Overlapping pads are still drawn in pad
+ * order.
+ * The size of the pool defaults to the number of processors and can be
+ * capped with the GST_REMAP_MAX_THREADS environment variable or the
+ * "max-threads" property.
+ *
+ * Setting "band-height" enables the low-latency mode: the output frame is
+ * rendered top to bottom in bands of that many rows across all pads, and an
+ * out-of-band "remap-band" custom event carrying the output buffer is sent
+ * downstream as soon as each band is complete, so that a slice-based
+ * encoder can start before the whole frame is done. Receivers must only map
+ * that buffer with GST_MAP_READ and only read the announced rows, the rest
+ * of the frame is still being rendered. This mode is ignored
+ * with "use-umat".
+ *
+ * Output pixels that no map covers are filled with the "background" colour.
+ * The uncovered areas are computed once whenever maps, positions or sizes
+ * change, so the per-frame cost only depends on the uncovered area.
  *
  */
 
@@ -59,6 +95,7 @@
 #include <string.h>
 
 #include "remap.h"
+#include "scheduler.h"
 
 #include <iostream>
 #include <opencv2/imgcodecs.hpp>
@@ -83,13 +120,15 @@ static void gst_remap_child_proxy_init(gpointer g_iface, gpointer iface_data);
 #define DEFAULT_PAD_YPOS 0
 #define DEFAULT_PAD_WIDTH 0
 #define DEFAULT_PAD_HEIGHT 0
+#define DEFAULT_PAD_PRIORITY 0
 enum {
     PROP_PAD_0,
     PROP_PAD_XPOS,
     PROP_PAD_YPOS,
     PROP_PAD_WIDTH,
     PROP_PAD_HEIGHT,
-    PROP_PAD_MAPS
+    PROP_PAD_MAPS,
+    PROP_PAD_PRIORITY
 };
 
 G_DEFINE_TYPE(
@@ -114,7 +153,12 @@ static void gst_remap_pad_get_property(
         g_value_set_int(value, pad->height);
         break;
     case PROP_PAD_MAPS:
+        GST_OBJECT_LOCK(pad);
         g_value_set_string(value, pad->maps);
+        GST_OBJECT_UNLOCK(pad);
+        break;
+    case PROP_PAD_PRIORITY:
+        g_value_set_uint(value, pad->priority);
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -122,6 +166,82 @@ static void gst_remap_pad_get_property(
     }
 }
 
+/* Decodes the maps file of the pad, may be called from any thread. The new
+ * maps and geometry are published under the element's object lock, which
+ * the aggregating thread holds while it reads them */
+static gboolean gst_remap_pad_load_maps(GstRemapPad* pad, GError** error)
+{
+    std::vector<cv::Mat> mats;
+    cv::Mat mapx, mapy;
+    cv::UMat u_mapx, u_mapy;
+    GstElement* parent;
+    gchar* path;
+    gboolean ret = FALSE;
+
+    GST_OBJECT_LOCK(pad);
+    path = g_strdup(pad->maps);
+    GST_OBJECT_UNLOCK(pad);
+
+    GST_DEBUG_OBJECT(pad, "Loading maps from %s", path);
+
+    try {
+        if (!cv::imreadmulti(path, mats,
+                cv::IMREAD_ANYDEPTH | cv::IMREAD_UNCHANGED
+                    | cv::IMREAD_ANYCOLOR)) {
+            g_set_error(error, GST_RESOURCE_ERROR,
+                GST_RESOURCE_ERROR_OPEN_READ, "Could not read maps from %s",
+                path);
+            goto done;
+        }
+        if (mats.size() != 2) {
+            g_set_error(error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+                "Expected 2 maps in %s, found %u", path, (guint)mats.size());
+            goto done;
+        }
+        cv::convertMaps(mats[0], mats[1], mapx, mapy, CV_16SC2);
+        u_mapx = mapx.getUMat(cv::ACCESS_READ);
+        u_mapy = mapy.getUMat(cv::ACCESS_READ);
+    } catch (const cv::Exception& e) {
+        g_set_error(error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+            "Could not convert maps from %s: %s", path, e.what());
+        goto done;
+    }
+
+    parent = gst_pad_get_parent_element(GST_PAD(pad));
+    if (parent != NULL)
+        GST_OBJECT_LOCK(parent);
+    GST_OBJECT_LOCK(pad);
+    pad->_mapx = mapx;
+    pad->_mapy = mapy;
+    pad->u_mapx = u_mapx;
+    pad->u_mapy = u_mapy;
+    pad->width = mapx.cols;
+    pad->height = mapx.rows;
+    pad->maps_dirty = FALSE;
+    pad->coverage_dirty = TRUE;
+    GST_OBJECT_UNLOCK(pad);
+    if (parent != NULL) {
+        GST_OBJECT_UNLOCK(parent);
+        gst_object_unref(parent);
+    }
+
+    gst_video_aggregator_convert_pad_update_conversion_info(
+        GST_VIDEO_AGGREGATOR_CONVERT_PAD(pad));
+    ret = TRUE;
+
+done:
+    g_free(path);
+    return ret;
+}
+
+static void _post_maps_error(
+    GstElement* element, GstRemapPad* pad, GError* error)
+{
+    GST_ELEMENT_ERROR(element, RESOURCE, READ,
+        ("Could not load maps for pad %s", GST_PAD_NAME(pad)),
+        ("%s", error->message));
+}
+
 static void gst_remap_pad_set_property(
     GObject* object, guint prop_id, const GValue* value, GParamSpec* pspec)
 {
@@ -142,35 +262,41 @@ static void gst_remap_pad_set_property(
         // readonly
         break;
     case PROP_PAD_MAPS:
-        pad->maps = g_value_get_string(value);
+        GST_OBJECT_LOCK(pad);
+        g_free(pad->maps);
+        pad->maps = g_value_dup_string(value);
+        pad->maps_dirty = TRUE;
+        GST_OBJECT_UNLOCK(pad);
         map_changed = true;
         break;
+    case PROP_PAD_PRIORITY:
+        pad->priority = g_value_get_uint(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
     }
 
+    /* Maps are only recorded here and loaded for all pads at once on the
+     * READY to PAUSED transition, unless the element is already running */
     if (map_changed) {
-        // TODO: Check for errors
-        std::vector<cv::Mat> mats;
-        if (!cv::imreadmulti(pad->maps, mats,
-                cv::IMREAD_ANYDEPTH | cv::IMREAD_UNCHANGED
-                    | cv::IMREAD_ANYCOLOR)) {
-            GST_ERROR_OBJECT(pad, ("Could not read filename %s"), (pad->maps));
-            return;
+        GstElement* parent = gst_pad_get_parent_element(GST_PAD(pad));
+        gboolean running = FALSE;
+        GError* error = NULL;
+
+        if (parent != NULL) {
+            GST_OBJECT_LOCK(parent);
+            running = GST_STATE(parent) >= GST_STATE_PAUSED;
+            GST_OBJECT_UNLOCK(parent);
         }
-        if (mats.size() != 2) {
-            GST_ERROR_OBJECT(pad, ("Wrong images count"), (NULL));
-            return;
+
+        if (running && !gst_remap_pad_load_maps(pad, &error)) {
+            _post_maps_error(parent, pad, error);
+            g_clear_error(&error);
         }
-        cv::convertMaps(mats[0], mats[1], pad->_mapx, pad->_mapy, CV_16SC2);
-        pad->u_mapx = pad->_mapx.getUMat(cv::ACCESS_READ);
-        pad->u_mapy = pad->_mapy.getUMat(cv::ACCESS_READ);
 
-        pad->width = pad->_mapx.cols;
-        pad->height = pad->_mapx.rows;
-        gst_video_aggregator_convert_pad_update_conversion_info(
-            GST_VIDEO_AGGREGATOR_CONVERT_PAD(pad));
+        if (parent != NULL)
+            gst_object_unref(parent);
     }
 }
 
@@ -269,6 +395,21 @@ static void gst_remap_pad_create_conversion_info(
     }
 }
 
+static void gst_remap_pad_finalize(GObject* object)
+{
+    GstRemapPad* pad = GST_REMAP_PAD(object);
+
+    g_free(pad->maps);
+    pad->_mapx.release();
+    pad->_mapy.release();
+    pad->u_mapx.release();
+    pad->u_mapy.release();
+    pad->cov_mask.release();
+    pad->cache.release();
+
+    G_OBJECT_CLASS(gst_remap_pad_parent_class)->finalize(object);
+}
+
 static void gst_remap_pad_class_init(GstRemapPadClass* klass)
 {
     GObjectClass* gobject_class = (GObjectClass*)klass;
@@ -279,6 +420,7 @@ static void gst_remap_pad_class_init(GstRemapPadClass* klass)
 
     gobject_class->set_property = gst_remap_pad_set_property;
     gobject_class->get_property = gst_remap_pad_get_property;
+    gobject_class->finalize = gst_remap_pad_finalize;
 
     g_object_class_install_property(gobject_class, PROP_PAD_XPOS,
         g_param_spec_int("xpos", "X Position", "X Position of the picture",
@@ -302,6 +444,12 @@ static void gst_remap_pad_class_init(GstRemapPadClass* klass)
         g_param_spec_string("maps", "Maps", "File path to maps", "",
             GParamFlags(G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE
                 | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_PAD_PRIORITY,
+        g_param_spec_uint("priority", "Priority",
+            "Priority of the picture when degrading under overload", 0,
+            G_MAXUINT, DEFAULT_PAD_PRIORITY,
+            GParamFlags(G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE
+                | G_PARAM_STATIC_STRINGS)));
 
     vaggcpadclass->create_conversion_info
         = GST_DEBUG_FUNCPTR(gst_remap_pad_create_conversion_info);
@@ -311,7 +459,14 @@ static void gst_remap_pad_init(GstRemapPad* compo_pad)
 {
     compo_pad->xpos = DEFAULT_PAD_XPOS;
     compo_pad->ypos = DEFAULT_PAD_YPOS;
-    compo_pad->maps = "";
+    compo_pad->maps = g_strdup("");
+    compo_pad->maps_dirty = FALSE;
+    compo_pad->coverage_dirty = TRUE;
+    compo_pad->cov_mask = cv::Mat();
+    compo_pad->cache = cv::Mat();
+    compo_pad->cache_valid = FALSE;
+    compo_pad->priority = DEFAULT_PAD_PRIORITY;
+    compo_pad->last_pts = GST_CLOCK_TIME_NONE;
     compo_pad->_mapx = cv::Mat();
     compo_pad->_mapy = cv::Mat();
     compo_pad->u_mapx = cv::UMat();
@@ -320,11 +475,38 @@ static void gst_remap_pad_init(GstRemapPad* compo_pad)
 
 /* GstRemap */
 #define DEFAULT_USE_UMAT FALSE
+#define DEFAULT_ADAPTIVE_QOS TRUE
+#define DEFAULT_MAX_THREADS 0
+#define DEFAULT_BAND_HEIGHT 0
+#define DEFAULT_BACKGROUND 0xff000000
 enum {
     PROP_0,
     PROP_USE_UMAT,
+    PROP_ADAPTIVE_QOS,
+    PROP_MAX_THREADS,
+    PROP_BAND_HEIGHT,
+    PROP_BACKGROUND,
 };
 
+/* Size of the part of a pad remapped by a single scheduler job. cv::remap
+ * only hands work to OpenCV's own thread pool for outputs of more than
+ * 2^16 pixels, keeping every job at that size runs it entirely on the worker
+ * that picked it, so the scheduler's thread cap holds for the remapping
+ * itself whatever OpenCV's threading backend is */
+#define STRIPE_HEIGHT 64
+#define STRIPE_WIDTH ((1 << 16) / STRIPE_HEIGHT)
+
+/* Consecutive late frames before stepping down a QoS level */
+#define QOS_DEGRADE_FRAMES 5
+/* From the SKIP level on, pads with a lower priority are restored from their
+ * cache, except for one of them per output frame which is remapped in turn.
+ * Each such pad is thus refreshed at the output rate divided by their
+ * number instead of freezing while the element stays degraded */
+/* Consecutive healthy frames before stepping back up a QoS level */
+#define QOS_RECOVER_FRAMES 50
+/* Downstream proportion below which we consider ourselves caught up */
+#define QOS_RECOVER_PROPORTION 0.8
+
 static void gst_remap_get_property(
     GObject* object, guint prop_id, GValue* value, GParamSpec* pspec)
 {
@@ -334,6 +516,24 @@ static void gst_remap_get_property(
     case PROP_USE_UMAT:
         g_value_set_boolean(value, self->use_umat);
         break;
+    case PROP_ADAPTIVE_QOS:
+        GST_OBJECT_LOCK(self);
+        g_value_set_boolean(value, self->adaptive_qos);
+        GST_OBJECT_UNLOCK(self);
+        break;
+    case PROP_MAX_THREADS:
+        g_value_set_uint(value, gst_remap_scheduler_get_max_threads());
+        break;
+    case PROP_BAND_HEIGHT:
+        GST_OBJECT_LOCK(self);
+        g_value_set_uint(value, self->band_height);
+        GST_OBJECT_UNLOCK(self);
+        break;
+    case PROP_BACKGROUND:
+        GST_OBJECT_LOCK(self);
+        g_value_set_uint(value, self->background);
+        GST_OBJECT_UNLOCK(self);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -349,6 +549,35 @@ static void gst_remap_set_property(
     case PROP_USE_UMAT:
         self->use_umat = g_value_get_boolean(value);
         break;
+    case PROP_ADAPTIVE_QOS:
+        GST_OBJECT_LOCK(self);
+        self->adaptive_qos = g_value_get_boolean(value);
+        if (!self->adaptive_qos)
+            self->qos_level = GST_REMAP_QOS_FULL;
+        GST_OBJECT_UNLOCK(self);
+        break;
+    case PROP_MAX_THREADS: {
+        guint old_threads = gst_remap_scheduler_get_max_threads();
+        guint max_threads = g_value_get_uint(value);
+
+        if (max_threads > 0 && max_threads != old_threads) {
+            GST_INFO_OBJECT(self,
+                "Changing the process-wide worker thread cap from %u to %u",
+                old_threads, max_threads);
+            gst_remap_scheduler_set_max_threads(max_threads);
+        }
+        break;
+    }
+    case PROP_BAND_HEIGHT:
+        GST_OBJECT_LOCK(self);
+        self->band_height = g_value_get_uint(value);
+        GST_OBJECT_UNLOCK(self);
+        break;
+    case PROP_BACKGROUND:
+        GST_OBJECT_LOCK(self);
+        self->background = g_value_get_uint(value);
+        GST_OBJECT_UNLOCK(self);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -467,6 +696,465 @@ static void _get_mat_from_frame(GstVideoFrame* frame, cv::Mat& mat)
         frame->map->data + GST_VIDEO_FRAME_PLANE_OFFSET(frame, 0), step);
 }
 
+static const gchar* _qos_level_name(GstRemapQosLevel level)
+{
+    switch (level) {
+    case GST_REMAP_QOS_FULL:
+        return "full";
+    case GST_REMAP_QOS_NEAREST:
+        return "nearest";
+    case GST_REMAP_QOS_SKIP:
+        return "skip";
+    case GST_REMAP_QOS_DROP:
+        return "drop";
+    }
+    return "unknown";
+}
+
+/* called with the object lock */
+static void gst_remap_reset_qos(GstRemap* self)
+{
+    self->qos_proportion = 0.0;
+    self->qos_diff = 0;
+    self->avg_processing = GST_CLOCK_TIME_NONE;
+    self->qos_level = GST_REMAP_QOS_FULL;
+    self->qos_late_frames = 0;
+    self->qos_good_frames = 0;
+    self->qos_frame_count = 0;
+    self->qos_refresh_count = 0;
+    self->drop_frame = FALSE;
+}
+
+/* Feeds the processing time of the last frame into the QoS state and steps
+ * the degradation level when needed. Returns a message to post if the level
+ * has changed. Called with the object lock. */
+static GstMessage* gst_remap_update_qos(
+    GstRemap* self, GstVideoAggregator* vagg, GstClockTime processing)
+{
+    GstClockTime duration;
+    GstRemapQosLevel old_level = self->qos_level;
+    gboolean late, healthy;
+
+    if (!self->adaptive_qos)
+        return NULL;
+
+    if (GST_VIDEO_INFO_FPS_N(&vagg->info) <= 0)
+        return NULL;
+    duration = gst_util_uint64_scale_int(GST_SECOND,
+        GST_VIDEO_INFO_FPS_D(&vagg->info), GST_VIDEO_INFO_FPS_N(&vagg->info));
+
+    if (!GST_CLOCK_TIME_IS_VALID(self->avg_processing))
+        self->avg_processing = processing;
+    else
+        self->avg_processing = (7 * self->avg_processing + processing) / 8;
+
+    late = self->qos_proportion > 1.0 || self->qos_diff > 0
+        || self->avg_processing > duration;
+    healthy = self->qos_proportion < QOS_RECOVER_PROPORTION
+        && self->qos_diff <= 0 && self->avg_processing < duration * 3 / 4;
+
+    if (late) {
+        self->qos_good_frames = 0;
+        if (++self->qos_late_frames >= QOS_DEGRADE_FRAMES
+            && self->qos_level < GST_REMAP_QOS_DROP) {
+            self->qos_level = (GstRemapQosLevel)(self->qos_level + 1);
+            self->qos_late_frames = 0;
+        }
+    } else if (healthy) {
+        self->qos_late_frames = 0;
+        if (++self->qos_good_frames >= QOS_RECOVER_FRAMES
+            && self->qos_level > GST_REMAP_QOS_FULL) {
+            self->qos_level = (GstRemapQosLevel)(self->qos_level - 1);
+            self->qos_good_frames = 0;
+        }
+    } else {
+        self->qos_late_frames = 0;
+        self->qos_good_frames = 0;
+    }
+
+    if (self->qos_level == old_level)
+        return NULL;
+
+    GST_INFO_OBJECT(self,
+        "QoS level %s -> %s (proportion %f, diff %" G_GINT64_FORMAT
+        ", processing %" GST_TIME_FORMAT ")",
+        _qos_level_name(old_level), _qos_level_name(self->qos_level),
+        self->qos_proportion, self->qos_diff,
+        GST_TIME_ARGS(self->avg_processing));
+
+    return gst_message_new_element(GST_OBJECT(self),
+        gst_structure_new("remap-qos", "level", G_TYPE_INT,
+            (gint)self->qos_level, "level-name", G_TYPE_STRING,
+            _qos_level_name(self->qos_level), "proportion", G_TYPE_DOUBLE,
+            self->qos_proportion, "diff", G_TYPE_INT64, self->qos_diff,
+            "processing-time", G_TYPE_UINT64, self->avg_processing, NULL));
+}
+
+/* Returns the highest priority among the pads and the number of pads with a
+ * lower one, called with the object lock */
+static guint _max_pad_priority(GstVideoAggregator* vagg, guint* n_low)
+{
+    GList* l;
+    guint max_priority = 0;
+
+    for (l = GST_ELEMENT(vagg)->sinkpads; l; l = l->next)
+        max_priority = MAX(max_priority, GST_REMAP_PAD(l->data)->priority);
+
+    *n_low = 0;
+    for (l = GST_ELEMENT(vagg)->sinkpads; l; l = l->next)
+        if (GST_REMAP_PAD(l->data)->priority < max_priority)
+            (*n_low)++;
+
+    return max_priority;
+}
+
+/* Whether the pad can be restored from its cache instead of being remapped
+ * at the current QoS level. Lower priority pads are skipped unless it is
+ * their turn to be refreshed. Called with the object lock */
+static gboolean _skip_pad(GstRemap* self, GstRemapPad* pad, GstClockTime pts,
+    guint max_priority, gboolean refresh)
+{
+    if (self->qos_level < GST_REMAP_QOS_SKIP)
+        return FALSE;
+    if (!pad->cache_valid || pad->cov_mask.empty())
+        return FALSE;
+    if (pad->priority < max_priority && !refresh)
+        return TRUE;
+    return GST_CLOCK_TIME_IS_VALID(pts) && pts == pad->last_pts;
+}
+
+/* A horizontal band of a single pad, remapped as one scheduler job. When
+ * mask is set the band is restored from the cache instead, otherwise the
+ * remapped band is saved to the cache if there is one */
+typedef struct {
+    GstRemapPad* pad;
+    cv::Mat src, dst, mapx, mapy;
+    cv::Mat cache, mask;
+    gint interpolation;
+    gboolean failed;
+} GstRemapStripe;
+
+/* Stripes of one output band that are rendered concurrently. Stripes of
+ * different pads in a batch never overlap, and the batches of a band run one
+ * after another, so where pads overlap the later one still ends up on top */
+typedef struct {
+    std::vector<GstRemapStripe> stripes;
+    /* canvas area of each pad in the batch */
+    std::vector<std::pair<GstRemapPad*, cv::Rect>> areas;
+} GstRemapStripeBatch;
+
+typedef std::vector<GstRemapStripeBatch> GstRemapBand;
+
+/* Appends the stripe covering rect to the last batch of the band, or opens a
+ * new batch if it would overlap another pad there */
+static void _band_add_stripe(
+    GstRemapBand& band, const GstRemapStripe& stripe, const cv::Rect& rect)
+{
+    GstRemapStripeBatch* batch = band.empty() ? NULL : &band.back();
+    gboolean found = FALSE;
+
+    if (batch != NULL) {
+        for (const auto& area : batch->areas) {
+            if (area.first != stripe.pad && (area.second & rect).area() > 0) {
+                batch = NULL;
+                break;
+            }
+        }
+    }
+    if (batch == NULL) {
+        band.emplace_back();
+        batch = &band.back();
+    }
+
+    for (auto& area : batch->areas) {
+        if (area.first == stripe.pad) {
+            area.second |= rect;
+            found = TRUE;
+            break;
+        }
+    }
+    if (!found)
+        batch->areas.push_back(std::make_pair(stripe.pad, rect));
+    batch->stripes.push_back(stripe);
+}
+
+/* Splits the pad into stripes of at most STRIPE_WIDTH x STRIPE_HEIGHT pixels
+ * and sorts them into the output bands of band_height rows they belong to */
+static void _add_stripes(std::vector<GstRemapBand>& bands,
+    gint band_height, const cv::Mat& src, const cv::Mat& roi,
+    GstRemapPad* pad, gint interpolation, gboolean restore)
+{
+    gint n_bands = bands.size();
+    gint y = 0;
+
+    while (y < pad->height) {
+        gint band = (pad->ypos + y) / band_height;
+        gint end = MIN(y + STRIPE_HEIGHT, pad->height);
+
+        if (band >= n_bands - 1)
+            band = n_bands - 1;
+        else
+            end = MIN(end, (band + 1) * band_height - pad->ypos);
+
+        for (gint x = 0; x < pad->width; x += STRIPE_WIDTH) {
+            cv::Rect rect(x, y, MIN(STRIPE_WIDTH, pad->width - x), end - y);
+            GstRemapStripe stripe;
+
+            stripe.pad = pad;
+            stripe.failed = FALSE;
+            stripe.dst = roi(rect);
+            if (!pad->cache.empty())
+                stripe.cache = pad->cache(rect);
+            if (restore) {
+                stripe.mask = pad->cov_mask(rect);
+            } else {
+                stripe.src = src;
+                stripe.mapx = pad->_mapx(rect);
+                stripe.mapy = pad->_mapy(rect);
+            }
+            stripe.interpolation = interpolation;
+            _band_add_stripe(bands[band], stripe,
+                rect + cv::Point(pad->xpos, pad->ypos));
+        }
+        y = end;
+    }
+}
+
+/* GThreadPool function pushing a queued band event */
+static void _push_band_event_func(gpointer data, gpointer user_data)
+{
+    GstRemap* self = GST_REMAP(user_data);
+
+    gst_pad_push_event(GST_AGGREGATOR_SRC_PAD(self), GST_EVENT(data));
+}
+
+/* Tells downstream that rows [y, y + height) of the output buffer are done.
+ * The rest of the buffer is still being written, so receivers may only map
+ * it for reading and only look at those rows.
+ *
+ * We are called with the videoaggregator's internal lock held, and a
+ * downstream handler querying or sending events upstream could deadlock
+ * against it. The event is therefore only queued here and pushed from a
+ * thread of its own, which also keeps downstream's handling time out of the
+ * processing time used for QoS. */
+static void _push_band_event(GstRemap* self, GstBuffer* outbuf, guint band,
+    guint n_bands, gint y, gint height)
+{
+    GstEvent* event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM_OOB,
+        gst_structure_new(GST_REMAP_BAND_EVENT, "buffer", GST_TYPE_BUFFER,
+            outbuf, "y", G_TYPE_INT, y, "height", G_TYPE_INT, height, "band",
+            G_TYPE_UINT, band, "n-bands", G_TYPE_UINT, n_bands, NULL));
+
+    GST_LOG_OBJECT(self, "band %u/%u done, rows %d-%d", band + 1, n_bands, y,
+        y + height);
+
+    /* a single thread keeps the events in order */
+    if (self->band_pool == NULL)
+        self->band_pool
+            = g_thread_pool_new(_push_band_event_func, self, 1, FALSE, NULL);
+    g_thread_pool_push(self->band_pool, event, NULL);
+}
+
+static void _remap_stripe(gpointer data, guint index)
+{
+    GstRemapStripe& stripe = (*(std::vector<GstRemapStripe>*)data)[index];
+
+    try {
+        if (!stripe.mask.empty()) {
+            stripe.cache.copyTo(stripe.dst, stripe.mask);
+            return;
+        }
+        cv::remap(stripe.src, stripe.dst, stripe.mapx, stripe.mapy,
+            stripe.interpolation, cv::BORDER_TRANSPARENT);
+        if (!stripe.cache.empty())
+            stripe.dst.copyTo(stripe.cache);
+    } catch (const cv::Exception& e) {
+        GST_WARNING("Could not remap stripe: %s", e.what());
+        stripe.failed = TRUE;
+    }
+}
+
+/* Whether maps, positions or sizes changed since the coverage was last
+ * computed, called with the object lock */
+static gboolean _coverage_changed(
+    GstRemap* self, GstVideoAggregator* vagg, gint width, gint height)
+{
+    GList* l;
+
+    if (width != self->coverage_width || height != self->coverage_height
+        || GST_ELEMENT(vagg)->numsinkpads != self->coverage_pads)
+        return TRUE;
+
+    for (l = GST_ELEMENT(vagg)->sinkpads; l; l = l->next) {
+        GstVideoAggregatorPad* vpad = (GstVideoAggregatorPad*)l->data;
+        GstRemapPad* pad = GST_REMAP_PAD(vpad);
+
+        if (pad->coverage_dirty || pad->cov_xpos != pad->xpos
+            || pad->cov_ypos != pad->ypos
+            || pad->cov_src_width != GST_VIDEO_INFO_WIDTH(&vpad->info)
+            || pad->cov_src_height != GST_VIDEO_INFO_HEIGHT(&vpad->info))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* Computes which canvas pixels are written by at least one map and stores
+ * the remaining ones as rectangles to fill with the background. Called with
+ * the object lock */
+static void gst_remap_update_coverage(
+    GstRemap* self, GstVideoAggregator* vagg, gint width, gint height)
+{
+    cv::Mat coverage = cv::Mat::zeros(height, width, CV_8UC1);
+    cv::Rect canvas(0, 0, width, height);
+    std::vector<guint> active, next_active;
+    GList* l;
+
+    for (l = GST_ELEMENT(vagg)->sinkpads; l; l = l->next) {
+        GstVideoAggregatorPad* vpad = (GstVideoAggregatorPad*)l->data;
+        GstRemapPad* pad = GST_REMAP_PAD(vpad);
+        std::vector<cv::Mat> xy;
+        cv::Mat inside;
+
+        pad->cov_xpos = pad->xpos;
+        pad->cov_ypos = pad->ypos;
+        pad->cov_src_width = GST_VIDEO_INFO_WIDTH(&vpad->info);
+        pad->cov_src_height = GST_VIDEO_INFO_HEIGHT(&vpad->info);
+        pad->coverage_dirty = FALSE;
+        pad->cov_mask.release();
+        pad->cache_valid = FALSE;
+
+        cv::Rect rect(pad->xpos, pad->ypos, pad->width, pad->height);
+        cv::Rect visible = rect & canvas;
+        if (pad->_mapx.empty() || visible.empty() || pad->cov_src_width <= 0
+            || pad->cov_src_height <= 0)
+            continue;
+
+        /* BORDER_TRANSPARENT leaves the pixels mapped outside of the source
+         * frame untouched. Bilinear remapping also skips the pixels whose
+         * 2x2 neighbourhood leaves the frame, i.e. those mapped to its last
+         * column or row, so those count as uncovered too. That is slightly
+         * conservative for nearest neighbour, which draws them over the
+         * background anyway */
+        cv::split(pad->_mapx, xy);
+        inside = (xy[0] >= 0) & (xy[0] < pad->cov_src_width - 1)
+            & (xy[1] >= 0) & (xy[1] < pad->cov_src_height - 1);
+        pad->cov_mask = inside;
+        cv::Mat dst = coverage(visible);
+        cv::bitwise_or(dst, inside(visible - rect.tl()), dst);
+    }
+
+    /* collect uncovered runs of each row, merging them with identical runs
+     * of the previous row */
+    g_array_set_size(self->background_rects, 0);
+    for (gint y = 0; y < height; y++) {
+        const uchar* row = coverage.ptr<uchar>(y);
+        gint x = 0;
+
+        next_active.clear();
+        while (x < width) {
+            gint x0;
+            gboolean merged = FALSE;
+
+            if (row[x]) {
+                x++;
+                continue;
+            }
+            for (x0 = x; x < width && !row[x]; x++)
+                ;
+
+            for (guint i : active) {
+                cv::Rect& r
+                    = g_array_index(self->background_rects, cv::Rect, i);
+                if (r.x == x0 && r.width == x - x0) {
+                    r.height++;
+                    next_active.push_back(i);
+                    merged = TRUE;
+                    break;
+                }
+            }
+            if (!merged) {
+                cv::Rect r(x0, y, x - x0, 1);
+                next_active.push_back(self->background_rects->len);
+                g_array_append_val(self->background_rects, r);
+            }
+        }
+        active.swap(next_active);
+    }
+
+    self->coverage_width = width;
+    self->coverage_height = height;
+    self->coverage_pads = GST_ELEMENT(vagg)->numsinkpads;
+
+    GST_DEBUG_OBJECT(self, "Canvas %dx%d has %u uncovered areas", width,
+        height, self->background_rects->len);
+}
+
+/* Fills the uncovered canvas areas, as well as the areas of pads that won't
+ * be drawn this time because they have no frame (not started yet, EOS or
+ * dropped by QoS). Must be called before any pad is drawn, so that pads
+ * overlapping an undrawn one still end up on top. Called with the object
+ * lock */
+static void _fill_background(
+    GstRemap* self, GstVideoAggregator* vagg, cv::Mat& outmat)
+{
+    cv::Scalar color((self->background >> 0) & 0xff,
+        (self->background >> 8) & 0xff, (self->background >> 16) & 0xff,
+        (self->background >> 24) & 0xff);
+    cv::Rect canvas(0, 0, outmat.cols, outmat.rows);
+    GList* l;
+
+    for (guint i = 0; i < self->background_rects->len; i++)
+        outmat(g_array_index(self->background_rects, cv::Rect, i))
+            .setTo(color);
+
+    for (l = GST_ELEMENT(vagg)->sinkpads; l; l = l->next) {
+        GstVideoAggregatorPad* vpad = (GstVideoAggregatorPad*)l->data;
+        GstRemapPad* pad = GST_REMAP_PAD(vpad);
+
+        if (pad->cov_mask.empty()
+            || gst_video_aggregator_pad_get_prepared_frame(vpad) != NULL)
+            continue;
+
+        cv::Rect rect(pad->cov_xpos, pad->cov_ypos, pad->cov_mask.cols,
+            pad->cov_mask.rows);
+        cv::Rect visible = rect & canvas;
+        if (visible.empty())
+            continue;
+        outmat(visible).setTo(color, pad->cov_mask(visible - rect.tl()));
+    }
+}
+
+/* Marks the caches of the remapped pads valid, unless one of their stripes
+ * failed and left the cache partly unwritten. Called with the object lock
+ * after all the stripes have run */
+static void _validate_caches(const std::vector<GstRemapBand>& bands)
+{
+    for (const auto& band : bands)
+        for (const auto& batch : band)
+            for (const GstRemapStripe& stripe : batch.stripes)
+                if (stripe.mask.empty() && !stripe.cache.empty())
+                    stripe.pad->cache_valid = TRUE;
+
+    for (const auto& band : bands)
+        for (const auto& batch : band)
+            for (const GstRemapStripe& stripe : batch.stripes)
+                if (stripe.failed)
+                    stripe.pad->cache_valid = FALSE;
+}
+
+/* Monotonic time in microseconds by which the current frame is due */
+static gint64 _frame_deadline(GstVideoAggregator* vagg, gint64 start_time)
+{
+    if (GST_VIDEO_INFO_FPS_N(&vagg->info) <= 0)
+        return start_time;
+
+    return start_time
+        + gst_util_uint64_scale_int(G_USEC_PER_SEC,
+            GST_VIDEO_INFO_FPS_D(&vagg->info),
+            GST_VIDEO_INFO_FPS_N(&vagg->info));
+}
+
 static GstFlowReturn gst_remap_aggregate_frames(
     GstVideoAggregator* vagg, GstBuffer* outbuf)
 {
@@ -474,16 +1162,52 @@ static GstFlowReturn gst_remap_aggregate_frames(
     GstVideoFrame out_frame, *outframe;
     guint drawn_pads = 0;
     GstRemap* self = GST_REMAP(vagg);
+    GstMessage* qos_msg;
+    gint64 start_time, deadline;
+    gint interpolation;
+    guint max_priority, n_low, low_index = 0, refresh_index = 0;
+    gint out_height, band_height;
+    gboolean push_bands;
+    GstMapFlags map_flags;
+    std::vector<GstRemapBand> bands;
 
-    if (!gst_video_frame_map(&out_frame, &vagg->info, outbuf, GST_MAP_WRITE)) {
+    GST_OBJECT_LOCK(vagg);
+    self->drop_frame = self->qos_level >= GST_REMAP_QOS_DROP
+        && (self->qos_frame_count++ % 2);
+    if (self->drop_frame) {
+        GST_OBJECT_UNLOCK(vagg);
+        GST_LOG_OBJECT(self, "Dropping frame due to QoS");
+        return GST_FLOW_OK;
+    }
+    push_bands = self->band_height > 0 && !self->use_umat;
+    band_height = self->band_height;
+    GST_OBJECT_UNLOCK(vagg);
+
+    /* downstream maps the buffer for reading while we are still rendering
+     * it, which a write-only mapping would refuse */
+    map_flags = push_bands ? GST_MAP_READWRITE : GST_MAP_WRITE;
+    if (!gst_video_frame_map(&out_frame, &vagg->info, outbuf, map_flags)) {
         GST_WARNING_OBJECT(vagg, "Could not map output buffer");
         return GST_FLOW_ERROR;
     }
 
+    start_time = g_get_monotonic_time();
     outframe = &out_frame;
     cv::Mat outmat, frame;
     _get_mat_from_frame(outframe, outmat);
+    out_height = GST_VIDEO_FRAME_HEIGHT(outframe);
+    if (!push_bands)
+        band_height = MAX(out_height, 1);
     GST_OBJECT_LOCK(vagg);
+    interpolation = self->qos_level >= GST_REMAP_QOS_NEAREST
+        ? cv::INTER_NEAREST
+        : cv::INTER_LINEAR;
+    max_priority = _max_pad_priority(vagg, &n_low);
+    if (self->qos_level >= GST_REMAP_QOS_SKIP && n_low > 0)
+        refresh_index = self->qos_refresh_count++ % n_low;
+    if (_coverage_changed(self, vagg, outmat.cols, outmat.rows))
+        gst_remap_update_coverage(self, vagg, outmat.cols, outmat.rows);
+    _fill_background(self, vagg, outmat);
     if (self->use_umat) {
         cv::UMat u_outmat = outmat.getUMat(cv::ACCESS_WRITE), u_frame;
 
@@ -494,41 +1218,235 @@ static GstFlowReturn gst_remap_aggregate_frames(
                 = gst_video_aggregator_pad_get_prepared_frame(pad);
 
             if (prepared_frame != NULL) {
+                /* no cache on the GPU path, so pads are never skipped */
+                compo_pad->cache.release();
+                compo_pad->cache_valid = FALSE;
                 _get_mat_from_frame(prepared_frame, frame);
                 u_frame = frame.getUMat(cv::ACCESS_READ);
                 cv::UMat u_roi(u_outmat,
                     cv::Rect(compo_pad->xpos, compo_pad->ypos,
                         compo_pad->width, compo_pad->height));
                 cv::remap(u_frame, u_roi, compo_pad->u_mapx, compo_pad->u_mapy,
-                    cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+                    interpolation, cv::BORDER_TRANSPARENT);
                 drawn_pads++;
             }
         }
     } else {
+        bands.resize(MAX((out_height + band_height - 1) / band_height, 1));
+
         for (l = GST_ELEMENT(vagg)->sinkpads; l; l = l->next) {
             GstVideoAggregatorPad* pad = (GstVideoAggregatorPad*)l->data;
             GstRemapPad* compo_pad = GST_REMAP_PAD(pad);
             GstVideoFrame* prepared_frame
                 = gst_video_aggregator_pad_get_prepared_frame(pad);
+            gboolean refresh = compo_pad->priority < max_priority
+                && low_index++ == refresh_index;
 
             if (prepared_frame != NULL) {
-                _get_mat_from_frame(prepared_frame, frame);
+                GstClockTime pts = GST_BUFFER_PTS(
+                    gst_video_aggregator_pad_get_current_buffer(pad));
+                gboolean restore = _skip_pad(
+                    self, compo_pad, pts, max_priority, refresh);
                 cv::Mat roi(outmat,
                     cv::Rect(compo_pad->xpos, compo_pad->ypos,
                         compo_pad->width, compo_pad->height));
-                cv::remap(frame, roi, compo_pad->_mapx, compo_pad->_mapy,
-                    cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+
+                /* keep a copy of the remapped pad from the first degraded
+                 * level on, so it is available once pads get skipped */
+                if (!restore) {
+                    if (self->qos_level >= GST_REMAP_QOS_NEAREST)
+                        compo_pad->cache.create(
+                            compo_pad->height, compo_pad->width, CV_8UC4);
+                    else
+                        compo_pad->cache.release();
+                    /* only valid once all its stripes are written */
+                    compo_pad->cache_valid = FALSE;
+                    compo_pad->last_pts = pts;
+                    _get_mat_from_frame(prepared_frame, frame);
+                }
+                _add_stripes(bands, band_height, frame, roi, compo_pad,
+                    interpolation, restore);
                 drawn_pads++;
             }
         }
     }
     GST_OBJECT_UNLOCK(vagg);
 
+    /* Pads can't be released while we are aggregating and the stripes hold
+     * their own references to the maps, so the bands are rendered without
+     * the object lock to be able to notify downstream in between */
+    deadline = _frame_deadline(vagg, start_time);
+    for (guint band = 0; band < bands.size(); band++) {
+        gint y = band * band_height;
+
+        for (auto& batch : bands[band])
+            gst_remap_scheduler_run(_remap_stripe, &batch.stripes,
+                batch.stripes.size(), deadline);
+        if (push_bands)
+            _push_band_event(self, outbuf, band, bands.size(), y,
+                MIN(band_height, out_height - y));
+    }
+
+    GST_OBJECT_LOCK(vagg);
+    _validate_caches(bands);
+    qos_msg = gst_remap_update_qos(
+        self, vagg, (g_get_monotonic_time() - start_time) * GST_USECOND);
+    GST_OBJECT_UNLOCK(vagg);
+
     gst_video_frame_unmap(outframe);
 
+    if (qos_msg)
+        gst_element_post_message(GST_ELEMENT(self), qos_msg);
+
     return GST_FLOW_OK;
 }
 
+static GstFlowReturn _finish_buffer(GstAggregator* agg, GstBuffer* buffer)
+{
+    GstRemap* self = GST_REMAP(agg);
+    gboolean drop;
+
+    GST_OBJECT_LOCK(self);
+    drop = self->drop_frame;
+    self->drop_frame = FALSE;
+    GST_OBJECT_UNLOCK(self);
+
+    if (drop) {
+        gst_buffer_unref(buffer);
+        return GST_FLOW_OK;
+    }
+
+    return GST_AGGREGATOR_CLASS(parent_class)->finish_buffer(agg, buffer);
+}
+
+static gboolean _src_event(GstAggregator* agg, GstEvent* event)
+{
+    GstRemap* self = GST_REMAP(agg);
+
+    if (GST_EVENT_TYPE(event) == GST_EVENT_QOS) {
+        GstQOSType type;
+        gdouble proportion;
+        GstClockTimeDiff diff;
+        GstClockTime timestamp;
+
+        gst_event_parse_qos(event, &type, &proportion, &diff, &timestamp);
+
+        GST_OBJECT_LOCK(self);
+        self->qos_proportion = proportion;
+        self->qos_diff = diff;
+        GST_OBJECT_UNLOCK(self);
+    }
+
+    return GST_AGGREGATOR_CLASS(parent_class)->src_event(agg, event);
+}
+
+static gboolean _stop(GstAggregator* agg)
+{
+    GstRemap* self = GST_REMAP(agg);
+
+    GST_OBJECT_LOCK(self);
+    gst_remap_reset_qos(self);
+    GST_OBJECT_UNLOCK(self);
+
+    /* streaming has stopped, let the queued band events go out */
+    if (self->band_pool != NULL) {
+        g_thread_pool_free(self->band_pool, FALSE, TRUE);
+        self->band_pool = NULL;
+    }
+
+    return GST_AGGREGATOR_CLASS(parent_class)->stop(agg);
+}
+
+typedef struct {
+    GPtrArray* pads;
+    GError** errors;
+} GstRemapMapsLoad;
+
+/* GThreadPool function, data is the pad index plus one */
+static void _load_pad_maps(gpointer data, gpointer user_data)
+{
+    GstRemapMapsLoad* load = (GstRemapMapsLoad*)user_data;
+    guint index = GPOINTER_TO_UINT(data) - 1;
+
+    gst_remap_pad_load_maps(GST_REMAP_PAD(g_ptr_array_index(load->pads, index)),
+        &load->errors[index]);
+}
+
+/* Loads the maps of all pads whose path changed in parallel, so startup
+ * takes as long as the slowest map. Decoding blocks for a long time, so it
+ * runs on a pool of its own instead of the shared per-frame scheduler, where
+ * it would stall the rendering of every other remap element */
+static gboolean gst_remap_load_maps(GstRemap* self)
+{
+    GstRemapMapsLoad load;
+    GThreadPool* pool;
+    gboolean ret = TRUE;
+    GList* l;
+    guint i;
+
+    load.pads = g_ptr_array_new_with_free_func(gst_object_unref);
+
+    GST_OBJECT_LOCK(self);
+    for (l = GST_ELEMENT(self)->sinkpads; l; l = l->next) {
+        GstRemapPad* pad = GST_REMAP_PAD(l->data);
+        gboolean dirty;
+
+        GST_OBJECT_LOCK(pad);
+        dirty = pad->maps_dirty;
+        GST_OBJECT_UNLOCK(pad);
+
+        if (dirty)
+            g_ptr_array_add(load.pads, gst_object_ref(pad));
+    }
+    GST_OBJECT_UNLOCK(self);
+
+    if (load.pads->len == 0) {
+        g_ptr_array_unref(load.pads);
+        return TRUE;
+    }
+
+    load.errors = g_new0(GError*, load.pads->len);
+
+    GST_DEBUG_OBJECT(self, "Loading maps for %u pads", load.pads->len);
+    pool = g_thread_pool_new(_load_pad_maps, &load,
+        MIN(load.pads->len, g_get_num_processors()), FALSE, NULL);
+    for (i = 0; i < load.pads->len; i++)
+        g_thread_pool_push(pool, GUINT_TO_POINTER(i + 1), NULL);
+    /* waits for all the loads to finish */
+    g_thread_pool_free(pool, FALSE, TRUE);
+
+    for (i = 0; i < load.pads->len; i++) {
+        if (load.errors[i] == NULL)
+            continue;
+        _post_maps_error(GST_ELEMENT(self),
+            GST_REMAP_PAD(g_ptr_array_index(load.pads, i)), load.errors[i]);
+        g_error_free(load.errors[i]);
+        ret = FALSE;
+    }
+
+    g_free(load.errors);
+    g_ptr_array_unref(load.pads);
+
+    return ret;
+}
+
+static GstStateChangeReturn gst_remap_change_state(
+    GstElement* element, GstStateChange transition)
+{
+    GstRemap* self = GST_REMAP(element);
+
+    switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+        if (!gst_remap_load_maps(self))
+            return GST_STATE_CHANGE_FAILURE;
+        break;
+    default:
+        break;
+    }
+
+    return GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+}
+
 static GstPad* gst_remap_request_new_pad(GstElement* element,
     GstPadTemplate* templ, const gchar* req_name, const GstCaps* caps)
 {
@@ -609,6 +1527,18 @@ static gboolean _sink_query(
 }
 
 /* GObject boilerplate */
+static void gst_remap_finalize(GObject* object)
+{
+    GstRemap* self = GST_REMAP(object);
+
+    g_array_unref(self->background_rects);
+    /* normally already freed in stop */
+    if (self->band_pool != NULL)
+        g_thread_pool_free(self->band_pool, TRUE, TRUE);
+
+    G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
 static void gst_remap_class_init(GstRemapClass* klass)
 {
     GObjectClass* gobject_class = (GObjectClass*)klass;
@@ -619,13 +1549,18 @@ static void gst_remap_class_init(GstRemapClass* klass)
 
     gobject_class->get_property = gst_remap_get_property;
     gobject_class->set_property = gst_remap_set_property;
+    gobject_class->finalize = gst_remap_finalize;
 
     gstelement_class->request_new_pad
         = GST_DEBUG_FUNCPTR(gst_remap_request_new_pad);
     gstelement_class->release_pad = GST_DEBUG_FUNCPTR(gst_remap_release_pad);
+    gstelement_class->change_state = GST_DEBUG_FUNCPTR(gst_remap_change_state);
     agg_class->sink_query = _sink_query;
     agg_class->fixate_src_caps = _fixate_caps;
     agg_class->negotiated_src_caps = _negotiated_caps;
+    agg_class->finish_buffer = _finish_buffer;
+    agg_class->src_event = _src_event;
+    agg_class->stop = _stop;
     videoaggregator_class->aggregate_frames = gst_remap_aggregate_frames;
 
     g_object_class_install_property(gobject_class, PROP_USE_UMAT,
@@ -633,6 +1568,30 @@ static void gst_remap_class_init(GstRemapClass* klass)
             DEFAULT_USE_UMAT,
             GParamFlags(G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE
                 | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_ADAPTIVE_QOS,
+        g_param_spec_boolean("adaptive-qos", "Adaptive QoS",
+            "Degrade quality in steps when downstream reports overload",
+            DEFAULT_ADAPTIVE_QOS,
+            GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_MAX_THREADS,
+        g_param_spec_uint("max-threads", "Maximum threads",
+            "Number of worker threads shared by all remap elements in the "
+            "process, changing it affects every remap element (0 = keep the "
+            "current value)",
+            0, GST_REMAP_SCHEDULER_MAX_THREADS, DEFAULT_MAX_THREADS,
+            GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_BAND_HEIGHT,
+        g_param_spec_uint("band-height", "Band height",
+            "Render the output in bands of this many rows and notify "
+            "downstream after each one (0 = whole frame at once)",
+            0, G_MAXINT, DEFAULT_BAND_HEIGHT,
+            GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_BACKGROUND,
+        g_param_spec_uint("background", "Background",
+            "Colour of the areas not covered by any map, as ARGB", 0,
+            G_MAXUINT32, DEFAULT_BACKGROUND,
+            GParamFlags(G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE
+                | G_PARAM_STATIC_STRINGS)));
 
     gst_element_class_add_static_pad_template_with_gtype(
         gstelement_class, &src_factory, GST_TYPE_AGGREGATOR_PAD);
@@ -649,6 +1608,14 @@ static void gst_remap_class_init(GstRemapClass* klass)
 static void gst_remap_init(GstRemap* self)
 { /* initialize variables */
     self->use_umat = FALSE;
+    self->adaptive_qos = DEFAULT_ADAPTIVE_QOS;
+    self->band_height = DEFAULT_BAND_HEIGHT;
+    self->background = DEFAULT_BACKGROUND;
+    self->background_rects = g_array_new(FALSE, FALSE, sizeof(cv::Rect));
+    self->band_pool = NULL;
+    self->coverage_width = self->coverage_height = 0;
+    self->coverage_pads = 0;
+    gst_remap_reset_qos(self);
 }
 
 /* GstChildProxy implementation */
@@ -693,6 +1660,7 @@ static void gst_remap_child_proxy_init(gpointer g_iface, gpointer iface_data)
 static gboolean plugin_init(GstPlugin* plugin)
 {
     GST_DEBUG_CATEGORY_INIT(gst_remap_debug, "remap", 0, "remap");
+    gst_remap_scheduler_init();
 
     return gst_element_register(
         plugin, "remap", GST_RANK_PRIMARY + 1, GST_TYPE_REMAP);
@@ -27,12 +27,45 @@
 
 G_BEGIN_DECLS
 
+/**
+ * GST_REMAP_BAND_EVENT:
+ *
+ * Name of the out-of-band custom downstream event sent in low-latency mode
+ * each time a band of the output buffer is complete. Its structure carries
+ * the "buffer" being rendered, the first row "y", the band "height" and the
+ * "band" index out of "n-bands".
+ *
+ * The buffer is still being written when the event arrives. Receivers must
+ * only map it with %GST_MAP_READ and only read rows [y, y + height), and
+ * must not modify or hold on to it beyond the frame.
+ */
+#define GST_REMAP_BAND_EVENT "remap-band"
+
 #define GST_TYPE_REMAP (gst_remap_get_type())
 G_DECLARE_FINAL_TYPE(GstRemap, gst_remap, GST, REMAP, GstVideoAggregator)
 
 #define GST_TYPE_REMAP_PAD (gst_remap_pad_get_type())
 G_DECLARE_FINAL_TYPE(
     GstRemapPad, gst_remap_pad, GST, REMAP_PAD, GstVideoAggregatorConvertPad)
+
+/**
+ * GstRemapQosLevel:
+ * @GST_REMAP_QOS_FULL: full quality, linear interpolation on every pad
+ * @GST_REMAP_QOS_NEAREST: nearest-neighbour interpolation
+ * @GST_REMAP_QOS_SKIP: show unchanged and low-priority pads from a cached copy
+ * of their last remapped picture instead of remapping them, low-priority pads
+ * are still refreshed in turn, one per output frame
+ * @GST_REMAP_QOS_DROP: additionally drop every other output frame
+ *
+ * Degradation steps taken by #GstRemap when downstream reports overload.
+ */
+typedef enum {
+    GST_REMAP_QOS_FULL,
+    GST_REMAP_QOS_NEAREST,
+    GST_REMAP_QOS_SKIP,
+    GST_REMAP_QOS_DROP,
+} GstRemapQosLevel;
+
 /**
  * GstRemap:
  *
@@ -41,6 +74,28 @@ G_DECLARE_FINAL_TYPE(
 struct _GstRemap {
     GstVideoAggregator videoaggregator;
     gboolean use_umat;
+    gboolean adaptive_qos;
+    guint band_height;
+    /* pushes the band events outside of the aggregating thread */
+    GThreadPool* band_pool;
+    guint background;
+
+    /* Canvas areas not covered by any map, as a GArray of cv::Rect, and the
+     * output size and number of pads they were computed for. Protected by
+     * the object lock */
+    GArray* background_rects;
+    gint coverage_width, coverage_height;
+    guint coverage_pads;
+
+    /* QoS state, protected by the object lock */
+    gdouble qos_proportion;
+    GstClockTimeDiff qos_diff;
+    GstClockTime avg_processing;
+    GstRemapQosLevel qos_level;
+    guint qos_late_frames, qos_good_frames;
+    guint64 qos_frame_count;
+    guint qos_refresh_count;
+    gboolean drop_frame;
 };
 
 /**
@@ -54,11 +109,28 @@ struct _GstRemapPad {
     /* properties */
     gint xpos, ypos;
     gint width, height;
-    const gchar* maps;
+    gchar* maps;
+    guint priority;
 
     /* maps */
     cv::Mat _mapx, _mapy;
     cv::UMat u_mapx, u_mapy;
+    /* maps path changed but not loaded yet */
+    gboolean maps_dirty;
+
+    /* geometry the canvas coverage was last computed for */
+    gint cov_xpos, cov_ypos, cov_src_width, cov_src_height;
+    gboolean coverage_dirty;
+    /* pixels of the pad's rectangle written by its maps */
+    cv::Mat cov_mask;
+
+    /* copy of the last remapped rectangle, kept while degraded so that the
+     * pad can be skipped */
+    cv::Mat cache;
+    gboolean cache_valid;
+
+    /* pts of the last remapped buffer, used to skip unchanged frames */
+    GstClockTime last_pts;
 };
 
 G_END_DECLS
@@ -0,0 +1,270 @@
+/* KnotInspector process-wide remap job scheduler
+ * Copyright (C) 2021 Vladislav Bortnikov <bortnikov@rerotor.ru>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * A single pool of worker threads shared by every remap element in the
+ * process, so that running many elements side by side does not oversubscribe
+ * the cores.
+ *
+ * Each worker owns a queue of jobs ordered by deadline. Batches are spread
+ * round-robin over the active workers, and a worker whose queue runs dry
+ * steals from the others. The number of active workers is capped globally,
+ * either by the GST_REMAP_MAX_THREADS environment variable or by the
+ * "max-threads" property of any remap element. Workers are only started by
+ * the first batch, so merely loading the plugin does not spawn any threads.
+ *
+ * OpenCV's global threading settings are left alone. Instead the remap
+ * element keeps each job small enough for cv::remap to run it in the calling
+ * worker without involving OpenCV's own thread pool, so the cap also bounds
+ * the threads doing the remapping.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "scheduler.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_remap_scheduler_debug);
+#define GST_CAT_DEFAULT gst_remap_scheduler_debug
+
+
+typedef struct {
+    GstRemapJobFunc func;
+    gpointer data;
+
+    GMutex lock;
+    GCond cond;
+    guint remaining;
+} GstRemapBatch;
+
+typedef struct {
+    GstRemapBatch* batch;
+    guint index;
+    gint64 deadline;
+} GstRemapJob;
+
+typedef struct {
+    GMutex lock;
+    GQueue jobs;
+    guint id;
+    GThread* thread;
+} GstRemapWorker;
+
+/* Workers are never destroyed, lowering the cap only parks them. The worker
+ * table and the counters are protected by the scheduler lock, each worker
+ * queue by its own lock. Never take the scheduler lock while holding a
+ * worker lock. */
+static struct {
+    GMutex lock;
+    GCond cond;
+    GstRemapWorker* workers[GST_REMAP_SCHEDULER_MAX_THREADS];
+    guint n_workers;
+    guint max_threads;
+    guint pending;
+    guint next;
+} scheduler;
+
+static gint _compare_deadline(gconstpointer a, gconstpointer b, gpointer)
+{
+    const GstRemapJob* queued = (const GstRemapJob*)a;
+    const GstRemapJob* job = (const GstRemapJob*)b;
+
+    /* keep FIFO order for equal deadlines */
+    return queued->deadline <= job->deadline ? -1 : 1;
+}
+
+static GstRemapJob* _pop_job(GstRemapWorker* worker)
+{
+    GstRemapJob* job;
+
+    g_mutex_lock(&worker->lock);
+    job = (GstRemapJob*)g_queue_pop_head(&worker->jobs);
+    g_mutex_unlock(&worker->lock);
+
+    return job;
+}
+
+static gpointer gst_remap_worker_func(gpointer user_data)
+{
+    GstRemapWorker* self = (GstRemapWorker*)user_data;
+
+    for (;;) {
+        GstRemapJob* job = NULL;
+        GstRemapBatch* batch;
+        guint n_workers, i;
+
+        /* claim one of the pending jobs, it is guaranteed to be in one of
+         * the queues until we take it */
+        g_mutex_lock(&scheduler.lock);
+        while (scheduler.pending == 0 || self->id >= scheduler.max_threads)
+            g_cond_wait(&scheduler.cond, &scheduler.lock);
+        scheduler.pending--;
+        n_workers = scheduler.n_workers;
+        g_mutex_unlock(&scheduler.lock);
+
+        job = _pop_job(self);
+        for (i = 1; job == NULL; i++)
+            job = _pop_job(scheduler.workers[(self->id + i) % n_workers]);
+
+        batch = job->batch;
+        batch->func(batch->data, job->index);
+
+        g_mutex_lock(&batch->lock);
+        if (--batch->remaining == 0)
+            g_cond_signal(&batch->cond);
+        g_mutex_unlock(&batch->lock);
+    }
+
+    return NULL;
+}
+
+/**
+ * gst_remap_scheduler_init:
+ *
+ * Sets up the shared scheduler. Called once from plugin_init, the worker
+ * threads themselves are started lazily by gst_remap_scheduler_run().
+ */
+void gst_remap_scheduler_init(void)
+{
+    const gchar* env;
+    guint max_threads = g_get_num_processors();
+
+    GST_DEBUG_CATEGORY_INIT(
+        gst_remap_scheduler_debug, "remapscheduler", 0, "remap scheduler");
+
+    env = g_getenv(GST_REMAP_SCHEDULER_THREADS_ENV);
+    if (env != NULL) {
+        guint64 value = g_ascii_strtoull(env, NULL, 10);
+        if (value > 0)
+            max_threads = (guint)MIN(value, GST_REMAP_SCHEDULER_MAX_THREADS);
+        else
+            GST_WARNING("Ignoring invalid %s=%s",
+                GST_REMAP_SCHEDULER_THREADS_ENV, env);
+    }
+
+    g_mutex_lock(&scheduler.lock);
+    scheduler.max_threads = max_threads;
+    g_mutex_unlock(&scheduler.lock);
+}
+
+guint gst_remap_scheduler_get_max_threads(void)
+{
+    guint max_threads;
+
+    g_mutex_lock(&scheduler.lock);
+    max_threads = scheduler.max_threads;
+    g_mutex_unlock(&scheduler.lock);
+
+    return max_threads;
+}
+
+/**
+ * gst_remap_scheduler_set_max_threads:
+ * @max_threads: the number of worker threads allowed to run jobs
+ *
+ * Changes the global cap on worker threads. This affects every remap
+ * element in the process.
+ */
+void gst_remap_scheduler_set_max_threads(guint max_threads)
+{
+    max_threads = CLAMP(max_threads, 1, GST_REMAP_SCHEDULER_MAX_THREADS);
+
+    g_mutex_lock(&scheduler.lock);
+    scheduler.max_threads = max_threads;
+    g_cond_broadcast(&scheduler.cond);
+    g_mutex_unlock(&scheduler.lock);
+
+    GST_INFO("Using up to %u worker threads", max_threads);
+}
+
+/* Starts workers up to the current cap, called with the scheduler lock */
+static void _start_workers(void)
+{
+    while (scheduler.n_workers < scheduler.max_threads) {
+        GstRemapWorker* worker = g_new0(GstRemapWorker, 1);
+        gchar* name = g_strdup_printf("remap-worker-%u", scheduler.n_workers);
+
+        g_mutex_init(&worker->lock);
+        g_queue_init(&worker->jobs);
+        worker->id = scheduler.n_workers;
+        worker->thread = g_thread_new(name, gst_remap_worker_func, worker);
+        g_free(name);
+
+        scheduler.workers[scheduler.n_workers++] = worker;
+    }
+}
+
+/**
+ * gst_remap_scheduler_run:
+ * @func: the function executing a single job
+ * @data: user data for @func
+ * @n_jobs: number of jobs in the batch
+ * @deadline: monotonic time in microseconds by which the batch should be
+ * done, batches with earlier deadlines are executed first
+ *
+ * Runs @n_jobs invocations of @func on the shared workers and blocks until
+ * all of them are finished.
+ */
+void gst_remap_scheduler_run(
+    GstRemapJobFunc func, gpointer data, guint n_jobs, gint64 deadline)
+{
+    GstRemapBatch batch;
+    GstRemapJob* jobs;
+    guint i;
+
+    if (n_jobs == 0)
+        return;
+
+    batch.func = func;
+    batch.data = data;
+    batch.remaining = n_jobs;
+    g_mutex_init(&batch.lock);
+    g_cond_init(&batch.cond);
+
+    jobs = g_new(GstRemapJob, n_jobs);
+
+    g_mutex_lock(&scheduler.lock);
+    g_assert(scheduler.max_threads > 0);
+    _start_workers();
+    for (i = 0; i < n_jobs; i++) {
+        GstRemapWorker* worker = scheduler.workers[scheduler.next++
+            % scheduler.max_threads];
+
+        jobs[i].batch = &batch;
+        jobs[i].index = i;
+        jobs[i].deadline = deadline;
+
+        g_mutex_lock(&worker->lock);
+        g_queue_insert_sorted(&worker->jobs, &jobs[i], _compare_deadline, NULL);
+        g_mutex_unlock(&worker->lock);
+    }
+    scheduler.pending += n_jobs;
+    g_cond_broadcast(&scheduler.cond);
+    g_mutex_unlock(&scheduler.lock);
+
+    g_mutex_lock(&batch.lock);
+    while (batch.remaining > 0)
+        g_cond_wait(&batch.cond, &batch.lock);
+    g_mutex_unlock(&batch.lock);
+
+    g_cond_clear(&batch.cond);
+    g_mutex_clear(&batch.lock);
+    g_free(jobs);
+}
@@ -0,0 +1,59 @@
+/* KnotInspector process-wide remap job scheduler
+ * Copyright (C) 2021 Vladislav Bortnikov <bortnikov@rerotor.ru>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_REMAP_SCHEDULER_H__
+#define __GST_REMAP_SCHEDULER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GST_REMAP_SCHEDULER_THREADS_ENV:
+ *
+ * Environment variable overriding the default number of worker threads.
+ */
+#define GST_REMAP_SCHEDULER_THREADS_ENV "GST_REMAP_MAX_THREADS"
+
+/**
+ * GST_REMAP_SCHEDULER_MAX_THREADS:
+ *
+ * Upper limit for the number of worker threads.
+ */
+#define GST_REMAP_SCHEDULER_MAX_THREADS 256
+
+/**
+ * GstRemapJobFunc:
+ * @data: user data passed to gst_remap_scheduler_run()
+ * @index: index of the job in the batch
+ *
+ * Executes a single job of a batch on one of the worker threads.
+ */
+typedef void (*GstRemapJobFunc)(gpointer data, guint index);
+
+void gst_remap_scheduler_init(void);
+
+guint gst_remap_scheduler_get_max_threads(void);
+void gst_remap_scheduler_set_max_threads(guint max_threads);
+
+void gst_remap_scheduler_run(
+    GstRemapJobFunc func, gpointer data, guint n_jobs, gint64 deadline);
+
+G_END_DECLS
+#endif /* __GST_REMAP_SCHEDULER_H__ */